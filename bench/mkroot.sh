@@ -0,0 +1,98 @@
+#!/bin/sh
+# Builds a synthetic sysroot for `bfetch --root`: mkroot.sh KIND DIR
+# KIND is arch, debian, gentoo, nix or bedrock. Every root gets the same /proc, /sys and
+# pci.ids; DIR/.expect lists the --format kv lines bfetch has to print for it.
+set -e
+kind=$1; root=$2
+[ -n "$kind" ] && [ -n "$root" ] || { echo "usage: $0 arch|debian|gentoo|nix|bedrock DIR" >&2; exit 1; }
+here=$(pwd)
+rm -rf "$root.tmp"; mkdir -p "$root.tmp"; cd "$root.tmp"
+
+mkdir -p etc proc/sys/kernel usr/share/hwdata sys/class/drm sys/devices/pci0000:00 sys/devices/system/cpu/cpu0/cpufreq
+printf '12345.67 45678.90\n' > proc/uptime
+printf '%s\n' 'MemTotal:       33554432 kB' 'MemFree:         4194304 kB' 'MemAvailable:   16777216 kB' \
+	'Buffers:          524288 kB' 'Cached:          8388608 kB' 'SwapCached:            0 kB' \
+	'SwapTotal:       8388608 kB' 'SwapFree:        6291456 kB' 'Shmem:           1048576 kB' \
+	'HugePages_Total:      16' 'HugePages_Free:        4' 'Hugepagesize:       2048 kB' > proc/meminfo
+printf 'processor\t: 0\nmodel name\t: Fixture CPU\n' > proc/cpuinfo
+echo 6.9.0-fixture > proc/sys/kernel/osrelease
+echo 0-15 > sys/devices/system/cpu/online
+echo 5000000 > sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq
+# A process table for the WM scan: 400 ordinary tasks, then the compositor
+for pid in $(seq 1 400); do mkdir -p proc/$pid; echo "task$pid" > proc/$pid/comm; done
+echo systemd > proc/1/comm; mkdir -p proc/812; echo Hyprland > proc/812/comm
+
+# A full-size pci.ids: ~2000 filler vendors around the three the cards use
+awk 'BEGIN {
+	print "# Synthetic pci.ids"
+	for (v = 1; v < 65536; v += 32) {
+		if (v > 0x1002 && !a) { a = 1; print "1002  Advanced Micro Devices, Inc. [AMD/ATI]\n\t744c  Navi 31 [Radeon RX 7900 XTX]" }
+		if (v > 0x10de && !n) { n = 1; print "10de  NVIDIA Corporation\n\t2684  AD102 [GeForce RTX 4090]" }
+		if (v > 0x8086 && !i) { i = 1; print "8086  Intel Corporation\n\t56a0  DG2 [Arc A770]" }
+		printf "%04x  Vendor %d\n", v, v
+		for (d = 0; d < 40; d++) {
+			printf "\t%04x  Device %d of vendor %d\n", d * 97 % 65536, d, v
+			if (d % 8 == 0) printf "\t\t%04x %04x  Subsystem %d\n", v, d, d
+		}
+	}
+	print "C 00  Unclassified device"
+}' > usr/share/hwdata/pci.ids
+
+# 8 DRM cards (4 NVIDIA, 2 AMD, 2 Intel), each with a render node on the same device
+for n in 0 1 2 3 4 5 6 7; do
+	case $n in 0|1|2|3) id="0x10de 0x2684";; 4|5) id="0x1002 0x744c";; *) id="0x8086 0x56a0";; esac
+	dev=sys/devices/pci0000:00/0000:0$((n + 1)):00.0
+	mkdir -p $dev sys/class/drm/card$n sys/class/drm/renderD$((128 + n))
+	set -- $id
+	echo $1 > $dev/vendor; echo $2 > $dev/device; echo 0x0000 > $dev/subsystem_vendor; echo 0x0000 > $dev/subsystem_device
+	ln -s ../../../devices/pci0000:00/0000:0$((n + 1)):00.0 sys/class/drm/card$n/device
+	ln -s ../../../devices/pci0000:00/0000:0$((n + 1)):00.0 sys/class/drm/renderD$((128 + n))/device
+	mkdir -p sys/class/drm/card$n-DP-1
+done
+
+echo "fixture-$kind" > etc/hostname
+os_release() { printf 'NAME="%s"\nPRETTY_NAME="%s"\nID=%s\n' "$1" "$1" "$2" > "${3:-.}/etc/os-release"; }
+pacman_db() { mkdir -p "$1" && (cd "$1" && seq -f "pkg%.0f-1.0-1" 1 "$2" | xargs mkdir); }
+dpkg_db() { mkdir -p "$1" && (cd "$1" && seq -f "pkg%.0f.list" 1 "$2" | xargs touch && seq -f "pkg%.0f.md5sums" 1 "$2" | xargs touch); }
+nix_manifest() {
+	mkdir -p "$(dirname "$1")"
+	awk -v n="$2" 'BEGIN { printf "{\"elements\":["; \
+		for (i = 0; i < n; i++) printf "%s{\"active\":true,\"attrPath\":\"legacyPackages.x86_64-linux.pkg%d\",\"originalUrl\":\"flake:nixpkgs\",\"outputs\":null,\"priority\":5,\"storePaths\":[\"/nix/store/%032d-pkg%d-1.0\"],\"url\":\"github:NixOS/nixpkgs/0123456789abcdef\"}", (i ? "," : ""), i, i, i; \
+		printf "],\"version\":2}" }' > "$1"
+}
+
+case $kind in
+arch)
+	os_release "Arch Linux" arch; pacman_db var/lib/pacman/local 100000
+	pkgs="100000 (pacman)"; distro="Arch Linux";;
+debian)
+	os_release "Debian GNU/Linux 12 (bookworm)" debian; dpkg_db var/lib/dpkg/info 30000
+	pkgs="30000 (dpkg)"; distro="Debian GNU/Linux 12 (bookworm)";;
+gentoo)
+	# 150 categories of 160 packages, each package dir holding the usual vdb files
+	os_release "Gentoo Linux" gentoo
+	for c in $(seq 1 150); do
+		d=var/db/pkg/cat-$c; mkdir -p $d
+		(cd $d && seq -f "pkg%.0f-1.0" 1 160 | xargs mkdir && for p in pkg*; do : > $p/CONTENTS; : > $p/SLOT; : > $p/USE; done)
+	done
+	pkgs="24000 (emerge)"; distro="Gentoo Linux";;
+nix)
+	os_release "NixOS 24.05 (Uakari)" nixos; nix_manifest nix/var/nix/profiles/default/manifest.json 20000
+	pkgs="20000 (nix)"; distro="NixOS 24.05 (Uakari)";;
+bedrock)
+	os_release "Bedrock Linux 0.7" bedrock
+	mkdir -p bedrock/strata/arch/etc; os_release "Arch Linux" arch bedrock/strata/arch
+	pacman_db bedrock/strata/arch/var/lib/pacman/local 1500
+	dpkg_db bedrock/strata/debian/var/lib/dpkg/info 2500
+	nix_manifest bedrock/strata/nix/nix/var/nix/profiles/default/manifest.json 300
+	ln -s arch bedrock/strata/tut
+	pkgs="1500 (pacman), 2500 (dpkg), 300 (nix)"; distro="Bedrock Linux 0.7";;
+*) echo "$0: unknown kind $kind" >&2; exit 1;;
+esac
+
+# terminal and shell come from the environment the Makefile's ROOT_ENV sets, not the root
+printf '%s\n' "distro=$distro" "kernel=6.9.0-fixture" "uptime=3h 25m" "wm=Hyprland" "memory=16.00 GiB / 32.00 GiB" \
+	"cpu=Fixture CPU (16) @ 5.00 GHz" "terminal=fixture-term" "shell=dash" \
+	"gpu=8 GPUs: 4x NVIDIA GeForce RTX 4090, 2x AMD Radeon RX 7900 XTX, 2x Arc A770" \
+	"packages=$pkgs" "swap=2.00 GiB / 8.00 GiB" "shmem=1.00 GiB" "hugepages=12 / 16 (2048 kB pages)" > .expect
+cd "$here"; rm -rf "$root"; mv "$root.tmp" "$root"
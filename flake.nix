@@ -25,12 +25,13 @@
             ];
 
             buildPhase = ''
-              make fast
+              make fast THEME_DIR=$out/share/bfetch/themes
             '';
 
             installPhase = ''
-              mkdir -p $out/bin
+              mkdir -p $out/bin $out/share/bfetch/themes
               cp bfetch $out/bin/
+              cp themes/*.theme $out/share/bfetch/themes/
             '';
 
             meta = with pkgs.lib; {
@@ -0,0 +1,674 @@
+// nolibc.h - the slice of libc bfetch needs, on raw syscalls (make tiny)
+//
+// Included at the top of fetch.c when built with -DBFETCH_TINY -nostdlib -static.
+// The system headers still provide types and prototypes; everything they declare
+// that fetch.c calls is defined here. Single-threaded: pthread_create always fails,
+// so the worker pool runs its jobs inline.
+
+#ifndef BFETCH_NOLIBC_H
+#define BFETCH_NOLIBC_H
+
+#define __NO_CTYPE 1    // plain ctype functions instead of glibc's locale tables
+// One thread, so thread-locals are plain globals (no TLS setup in _start). This is what makes
+// every tiny build serial: pthread_create below has to keep failing, or workers would share
+// t_stage, t_root_fd and t_dents with the main thread.
+#define __thread
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <sys/uio.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+// --------------------------------------------------------------------------------
+// Entry Point and Syscalls
+// --------------------------------------------------------------------------------
+
+char** environ;
+static int tiny_errno;
+
+int* __errno_location(void) {
+    return &tiny_errno;
+}
+
+static long tiny_syscall6(long n, long a, long b, long c, long d, long e, long f) {
+#if defined(__x86_64__)
+    register long r10 __asm__("r10") = d;
+    register long r8 __asm__("r8") = e;
+    register long r9 __asm__("r9") = f;
+    long ret;
+    __asm__ volatile ("syscall" : "=a"(ret) : "a"(n), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8), "r"(r9)
+                      : "rcx", "r11", "memory");
+    return ret;
+#elif defined(__aarch64__)
+    register long x8 __asm__("x8") = n;
+    register long x0 __asm__("x0") = a;
+    register long x1 __asm__("x1") = b;
+    register long x2 __asm__("x2") = c;
+    register long x3 __asm__("x3") = d;
+    register long x4 __asm__("x4") = e;
+    register long x5 __asm__("x5") = f;
+    __asm__ volatile ("svc 0" : "+r"(x0) : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5) : "memory");
+    return x0;
+#else
+#error "make tiny supports x86_64 and aarch64 only"
+#endif
+}
+
+// Kernel returns -errno; libc convention is -1 with errno set
+static long tiny_ret(long r) {
+    if (r < 0 && r > -4096) { tiny_errno = (int)-r; return -1; }
+    return r;
+}
+
+#define SYS6(n, a, b, c, d, e, f) tiny_ret(tiny_syscall6((n), (long)(a), (long)(b), (long)(c), (long)(d), (long)(e), (long)(f)))
+#define SYS3(n, a, b, c) SYS6(n, a, b, c, 0, 0, 0)
+
+// syscall(2) as a macro: missing arguments are padded with zeros at the call site instead of
+// va_arg reading six that were never passed
+#define TINY_SYSCALL(n, a, b, c, d, e, f, ...) SYS6(n, a, b, c, d, e, f)
+#define syscall(...) TINY_SYSCALL(__VA_ARGS__, 0, 0, 0, 0, 0, 0)
+
+__attribute__((noreturn)) void _exit(int status) {
+    for (;;) tiny_syscall6(SYS_exit_group, status, 0, 0, 0, 0, 0);
+}
+
+int main(int argc, char* argv[]);
+
+// The kernel leaves argc, argv[] and envp[] on the stack; no TLS, no atexit, no stdio to flush
+__attribute__((used, noreturn)) void tiny_start(long* sp);
+
+void tiny_start(long* sp) {
+    int argc = (int)sp[0];
+    char** argv = (char**)(sp + 1);
+    environ = argv + argc + 1;
+    _exit(main(argc, argv));
+}
+
+#if defined(__x86_64__)
+__asm__(".text\n.global _start\n_start:\n\txor %ebp, %ebp\n\tmov %rsp, %rdi\n\tand $-16, %rsp\n\tcall tiny_start\n\thlt\n");
+#else
+__asm__(".text\n.global _start\n_start:\n\tmov x29, #0\n\tmov x30, #0\n\tmov x0, sp\n\tbl tiny_start\n");
+#endif
+
+int open(const char* path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    int mode = (flags & (O_CREAT | O_TMPFILE)) ? va_arg(ap, int) : 0;
+    va_end(ap);
+    return SYS6(SYS_openat, AT_FDCWD, path, flags, mode, 0, 0);
+}
+
+int openat(int dirfd, const char* path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    int mode = (flags & (O_CREAT | O_TMPFILE)) ? va_arg(ap, int) : 0;
+    va_end(ap);
+    return SYS6(SYS_openat, dirfd, path, flags, mode, 0, 0);
+}
+
+int close(int fd) { return SYS3(SYS_close, fd, 0, 0); }
+ssize_t read(int fd, void* buf, size_t n) { return SYS3(SYS_read, fd, buf, n); }
+ssize_t write(int fd, const void* buf, size_t n) { return SYS3(SYS_write, fd, buf, n); }
+ssize_t writev(int fd, const struct iovec* iov, int n) { return SYS3(SYS_writev, fd, iov, n); }
+off_t lseek(int fd, off_t off, int whence) { return SYS3(SYS_lseek, fd, off, whence); }
+ssize_t pread(int fd, void* buf, size_t n, off_t off) { return SYS6(SYS_pread64, fd, buf, n, off, 0, 0); }
+int fstat(int fd, struct stat* st) { return SYS6(SYS_newfstatat, fd, "", st, AT_EMPTY_PATH, 0, 0); }
+int statx(int dirfd, const char* path, int flags, unsigned int mask, struct statx* st) { return SYS6(SYS_statx, dirfd, path, flags, mask, st, 0); }
+int access(const char* path, int mode) { return SYS3(SYS_faccessat, AT_FDCWD, path, mode); }
+int mkdir(const char* path, mode_t mode) { return SYS3(SYS_mkdirat, AT_FDCWD, path, mode); }
+int unlink(const char* path) { return SYS3(SYS_unlinkat, AT_FDCWD, path, 0); }
+int rename(const char* from, const char* to) { return SYS6(SYS_renameat2, AT_FDCWD, from, AT_FDCWD, to, 0, 0); }
+ssize_t readlinkat(int dirfd, const char* path, char* buf, size_t n) { return SYS6(SYS_readlinkat, dirfd, path, buf, n, 0, 0); }
+int uname(struct utsname* u) { return SYS3(SYS_uname, u, 0, 0); }
+pid_t getpid(void) { return SYS3(SYS_getpid, 0, 0, 0); }
+pid_t getppid(void) { return SYS3(SYS_getppid, 0, 0, 0); }
+pid_t setsid(void) { return SYS3(SYS_setsid, 0, 0, 0); }
+// dup3 rejects from == to with EINVAL; dup2 returns to if it is open (aarch64 has no SYS_dup2)
+int dup2(int from, int to) {
+    if (from == to) return SYS3(SYS_fcntl, from, F_GETFD, 0) < 0 ? -1 : to;
+    return SYS3(SYS_dup3, from, to, 0);
+}
+int execve(const char* path, char* const argv[], char* const envp[]) { return SYS3(SYS_execve, path, argv, envp); }
+pid_t waitpid(pid_t pid, int* status, int options) { return SYS6(SYS_wait4, pid, status, options, 0, 0, 0); }
+pid_t wait4(pid_t pid, int* status, int options, struct rusage* ru) { return SYS6(SYS_wait4, pid, status, options, ru, 0, 0); }
+int getrusage(__rusage_who_t who, struct rusage* ru) { return SYS3(SYS_getrusage, who, ru, 0); }
+pid_t fork(void) { return SYS6(SYS_clone, SIGCHLD, 0, 0, 0, 0, 0); }
+int clock_gettime(clockid_t clk, struct timespec* ts) { return SYS3(SYS_clock_gettime, clk, ts, 0); }
+int nanosleep(const struct timespec* req, struct timespec* rem) { return SYS3(SYS_nanosleep, req, rem, 0); }
+
+void* mmap(void* addr, size_t len, int prot, int flags, int fd, off_t off) {
+    long r = tiny_syscall6(SYS_mmap, (long)addr, len, prot, flags, fd, off);
+    if (r < 0 && r > -4096) { tiny_errno = (int)-r; return MAP_FAILED; }
+    return (void*)r;
+}
+
+int munmap(void* addr, size_t len) { return SYS3(SYS_munmap, addr, len, 0); }
+int mprotect(void* addr, size_t len, int prot) { return SYS3(SYS_mprotect, addr, len, prot); }
+
+int get_nprocs(void) {
+    unsigned long mask[16] = {0};
+    long n = SYS3(SYS_sched_getaffinity, 0, sizeof(mask), mask);
+    int count = 0;
+    for (long i = 0; i < n / (long)sizeof(mask[0]); i++) count += __builtin_popcountl(mask[i]);
+    return count ? count : 1;
+}
+
+// The kernel copies only nr_cpu_ids bits; glibc clears the rest of the set
+int sched_getaffinity(pid_t pid, size_t size, cpu_set_t* mask) {
+    long n = SYS3(SYS_sched_getaffinity, pid, size, mask);
+    if (n < 0) return -1;
+    memset((char*)mask + n, 0, size - (size_t)n);
+    return 0;
+}
+int sched_setaffinity(pid_t pid, size_t size, const cpu_set_t* mask) { return SYS3(SYS_sched_setaffinity, pid, size, mask); }
+
+// Always fails, so the pool runs every job inline (see __thread above)
+int pthread_create(pthread_t* t, const pthread_attr_t* attr, void* (*fn)(void*), void* arg) {
+    (void)t; (void)attr; (void)fn; (void)arg;
+    return EAGAIN;
+}
+
+int pthread_join(pthread_t t, void** ret) {
+    (void)t; (void)ret;
+    return 0;
+}
+
+int pthread_attr_init(pthread_attr_t* attr) { (void)attr; return 0; }
+int pthread_attr_destroy(pthread_attr_t* attr) { (void)attr; return 0; }
+int pthread_attr_setstack(pthread_attr_t* attr, void* stack, size_t size) { (void)attr; (void)stack; (void)size; return 0; }
+
+// --------------------------------------------------------------------------------
+// Strings and Memory
+// --------------------------------------------------------------------------------
+
+__attribute__((used)) void* memcpy(void* restrict dst, const void* restrict src, size_t n) {
+    unsigned char* d = dst;
+    const unsigned char* s = src;
+    while (n--) *d++ = *s++;
+    return dst;
+}
+
+__attribute__((used)) void* memmove(void* dst, const void* src, size_t n) {
+    unsigned char* d = dst;
+    const unsigned char* s = src;
+    if (d < s) while (n--) *d++ = *s++;
+    else while (n--) d[n] = s[n];
+    return dst;
+}
+
+__attribute__((used)) void* memset(void* dst, int c, size_t n) {
+    unsigned char* d = dst;
+    while (n--) *d++ = (unsigned char)c;
+    return dst;
+}
+
+__attribute__((used)) int memcmp(const void* a, const void* b, size_t n) {
+    const unsigned char* x = a;
+    const unsigned char* y = b;
+    for (; n; n--, x++, y++) if (*x != *y) return *x - *y;
+    return 0;
+}
+
+void* memchr(const void* p, int c, size_t n) {
+    const unsigned char* s = p;
+    for (; n; n--, s++) if (*s == (unsigned char)c) return (void*)s;
+    return NULL;
+}
+
+void* memmem(const void* hay, size_t hlen, const void* needle, size_t nlen) {
+    const char* h = hay;
+    if (nlen == 0) return (void*)h;
+    for (const char* end = h + hlen; (size_t)(end - h) >= nlen; h++) {
+        h = memchr(h, *(const char*)needle, end - h - nlen + 1);
+        if (!h) return NULL;
+        if (memcmp(h, needle, nlen) == 0) return (void*)h;
+    }
+    return NULL;
+}
+
+size_t strlen(const char* s) {
+    const char* p = s;
+    while (*p) p++;
+    return p - s;
+}
+
+size_t strnlen(const char* s, size_t max) {
+    size_t n = 0;
+    while (n < max && s[n]) n++;
+    return n;
+}
+
+int strcmp(const char* a, const char* b) {
+    while (*a && *a == *b) a++, b++;
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+int strncmp(const char* a, const char* b, size_t n) {
+    for (; n; n--, a++, b++) if (*a != *b || !*a) return (unsigned char)*a - (unsigned char)*b;
+    return 0;
+}
+
+int tolower(int c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+int toupper(int c) { return (c >= 'a' && c <= 'z') ? c - 32 : c; }
+int isdigit(int c) { return c >= '0' && c <= '9'; }
+int isspace(int c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+int isxdigit(int c) { return isdigit(c) || ((c | 32) >= 'a' && (c | 32) <= 'f'); }
+
+int strncasecmp(const char* a, const char* b, size_t n) {
+    for (; n; n--, a++, b++) {
+        int x = tolower((unsigned char)*a), y = tolower((unsigned char)*b);
+        if (x != y || !x) return x - y;
+    }
+    return 0;
+}
+
+char* strcasestr(const char* hay, const char* needle) {
+    size_t n = strlen(needle);
+    for (; *hay; hay++) if (strncasecmp(hay, needle, n) == 0) return (char*)hay;
+    return n ? NULL : (char*)hay;
+}
+
+char* strchr(const char* s, int c) {
+    for (;; s++) {
+        if (*s == (char)c) return (char*)s;
+        if (!*s) return NULL;
+    }
+}
+
+char* strrchr(const char* s, int c) {
+    const char* last = NULL;
+    for (;; s++) {
+        if (*s == (char)c) last = s;
+        if (!*s) return (char*)last;
+    }
+}
+
+char* strstr(const char* hay, const char* needle) {
+    return memmem(hay, strlen(hay), needle, strlen(needle));
+}
+
+char* strcpy(char* dst, const char* src) {
+    char* d = dst;
+    while ((*d++ = *src++)) {}
+    return dst;
+}
+
+char* strncpy(char* dst, const char* src, size_t n) {
+    size_t i = 0;
+    for (; i < n && src[i]; i++) dst[i] = src[i];
+    for (; i < n; i++) dst[i] = '\0';
+    return dst;
+}
+
+char* getenv(const char* name) {
+    size_t n = strlen(name);
+    for (char** e = environ; e && *e; e++) {
+        if (strncmp(*e, name, n) == 0 && (*e)[n] == '=') return *e + n + 1;
+    }
+    return NULL;
+}
+
+unsigned long long strtoull(const char* s, char** end, int base) {
+    while (isspace((unsigned char)*s)) s++;
+    if (*s == '+') s++;
+    if ((base == 0 || base == 16) && s[0] == '0' && (s[1] | 32) == 'x') { s += 2; base = 16; }
+    if (base == 0) base = 10;
+    unsigned long long v = 0;
+    for (;; s++) {
+        int c = (unsigned char)*s;
+        int d = isdigit(c) ? c - '0' : ((c | 32) >= 'a' && (c | 32) <= 'z') ? (c | 32) - 'a' + 10 : 99;
+        if (d >= base) break;
+        v = v * base + d;
+    }
+    if (end) *end = (char*)s;
+    return v;
+}
+
+unsigned long strtoul(const char* s, char** end, int base) { return strtoull(s, end, base); }
+
+long strtol(const char* s, char** end, int base) {
+    while (isspace((unsigned char)*s)) s++;
+    int neg = *s == '-';
+    if (neg) s++;
+    long v = (long)strtoull(s, end, base);
+    return neg ? -v : v;
+}
+
+int atoi(const char* s) { return (int)strtol(s, NULL, 10); }
+
+// Plain decimals only ("1234.5"), which is all /sys and /proc hand us
+double strtod(const char* s, char** end) {
+    char* p;
+    while (isspace((unsigned char)*s)) s++;
+    int neg = *s == '-';
+    if (neg || *s == '+') s++;
+    double v = (double)strtoull(s, &p, 10);
+    if (*p == '.') {
+        double scale = 0.1;
+        for (p++; isdigit((unsigned char)*p); p++, scale *= 0.1) v += (*p - '0') * scale;
+    }
+    if (end) *end = p;
+    return neg ? -v : v;
+}
+
+// Heapsort: no recursion, no scratch memory
+static void tiny_swap(char* a, char* b, size_t size) {
+    while (size--) { char t = *a; *a++ = *b; *b++ = t; }
+}
+
+static void tiny_sift(char* base, size_t root, size_t n, size_t size, int (*cmp)(const void*, const void*)) {
+    for (size_t child; (child = 2 * root + 1) < n; root = child) {
+        if (child + 1 < n && cmp(base + child * size, base + (child + 1) * size) < 0) child++;
+        if (cmp(base + root * size, base + child * size) >= 0) return;
+        tiny_swap(base + root * size, base + child * size, size);
+    }
+}
+
+void qsort(void* base, size_t n, size_t size, int (*cmp)(const void*, const void*)) {
+    char* b = base;
+    for (size_t i = n / 2; i-- > 0; ) tiny_sift(b, i, n, size, cmp);
+    for (size_t i = n; i-- > 1; ) {
+        tiny_swap(b, b + i * size, size);
+        tiny_sift(b, 0, i, size, cmp);
+    }
+}
+
+// --------------------------------------------------------------------------------
+// Allocation: bump arenas for small blocks, one mapping per large block
+// --------------------------------------------------------------------------------
+
+#define TINY_ARENA (256 * 1024)
+#define TINY_LARGE (64 * 1024)
+
+struct tiny_block {
+    size_t size;
+    size_t mapped;  // length of the block's own mapping, 0 when it lives in an arena
+};
+
+static char* g_arena;
+static size_t g_arena_left;
+
+void* malloc(size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    size_t total = size + sizeof(struct tiny_block) + 16;
+    struct tiny_block* b;
+    if (size >= TINY_LARGE) {
+        b = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (b == MAP_FAILED) return NULL;
+        b->mapped = total;
+    } else {
+        if (g_arena_left < total) {
+            g_arena = mmap(NULL, TINY_ARENA, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (g_arena == MAP_FAILED) { g_arena_left = 0; return NULL; }
+            g_arena_left = TINY_ARENA;
+        }
+        b = (struct tiny_block*)g_arena;
+        g_arena += total;
+        g_arena_left -= total;
+        b->mapped = 0;
+    }
+    b->size = size;
+    return (char*)b + 16;
+}
+
+void free(void* p) {
+    if (!p) return;
+    struct tiny_block* b = (struct tiny_block*)((char*)p - 16);
+    if (b->mapped) munmap(b, b->mapped);
+}
+
+void* calloc(size_t n, size_t size) {
+    if (size && n > (size_t)-1 / size) return NULL;
+    void* p = malloc(n * size);
+    if (p) memset(p, 0, n * size);
+    return p;
+}
+
+void* realloc(void* p, size_t size) {
+    void* q = malloc(size);
+    if (!q || !p) return q;
+    struct tiny_block* b = (struct tiny_block*)((char*)p - 16);
+    memcpy(q, p, b->size < size ? b->size : size);
+    free(p);
+    return q;
+}
+
+// --------------------------------------------------------------------------------
+// Formatting: %d %u %x %s %c %f with flags, width, precision and h/l/ll/z
+// --------------------------------------------------------------------------------
+
+struct tiny_out {
+    char* buf;
+    size_t size;
+    size_t len;
+};
+
+static void tiny_putc(struct tiny_out* o, char c) {
+    if (o->len + 1 < o->size) o->buf[o->len] = c;
+    o->len++;
+}
+
+static void tiny_pad(struct tiny_out* o, char c, int n) {
+    while (n-- > 0) tiny_putc(o, c);
+}
+
+// Digits of v in base 10 or 16, most significant first; returns the count
+static int tiny_digits(char* out, unsigned long long v, int base) {
+    char tmp[24];
+    int n = 0;
+    do { tmp[n++] = "0123456789abcdef"[v % base]; v /= base; } while (v);
+    for (int i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+// Fixed-point %.Nf: the integer part and the fraction scaled by 10^N are converted apart, so
+// nothing overflows below 1e19; past that the leading digits are kept and the rest zero-filled
+static int tiny_fixed(char* out, double v, int prec) {
+    int n = 0, zeros = 0;
+    if (v != v) { memcpy(out, "nan", 3); return 3; }
+    if (v < 0) { out[n++] = '-'; v = -v; }
+    if (v > 1.7976931348623157e308) { memcpy(out + n, "inf", 3); return n + 3; }
+    if (prec > 9) prec = 9;
+    unsigned long long scale = 1;
+    for (int i = 0; i < prec; i++) scale *= 10;
+    while (v >= 1e19) { v /= 10; zeros++; }
+    unsigned long long ip = (unsigned long long)v;
+    unsigned long long frac = zeros ? 0 : (unsigned long long)((v - ip) * scale + 0.5);
+    if (frac >= scale) { ip++; frac -= scale; }     // 0.9996 at %.3f carries into the integer part
+    n += tiny_digits(out + n, ip, 10);
+    while (zeros-- > 0) out[n++] = '0';
+    if (prec) {
+        out[n++] = '.';
+        for (unsigned long long d = scale / 10; d; d /= 10) out[n++] = '0' + (frac / d) % 10;
+    }
+    return n;
+}
+
+int vsnprintf(char* buf, size_t size, const char* fmt, va_list ap) {
+    struct tiny_out o = { buf, size, 0 };
+    for (; *fmt; fmt++) {
+        if (*fmt != '%') { tiny_putc(&o, *fmt); continue; }
+        int left = 0, zero = 0, width = 0, prec = -1, lng = 0;
+        for (fmt++; *fmt == '-' || *fmt == '0'; fmt++) { if (*fmt == '-') left = 1; else zero = 1; }
+        if (*fmt == '*') { width = va_arg(ap, int); fmt++; }
+        else while (isdigit((unsigned char)*fmt)) width = width * 10 + (*fmt++ - '0');
+        if (*fmt == '.') {
+            prec = 0;
+            if (*++fmt == '*') { prec = va_arg(ap, int); fmt++; }
+            else while (isdigit((unsigned char)*fmt)) prec = prec * 10 + (*fmt++ - '0');
+        }
+        for (; *fmt == 'l' || *fmt == 'z' || *fmt == 'h'; fmt++) if (*fmt != 'h') lng++;
+
+        char num[320];      // %f of DBL_MAX: 309 integer digits, sign, point and 9 decimals
+        const char* s = num;
+        int n = 0;
+        switch (*fmt) {
+        case 'd': case 'i': {
+            long long v = lng ? va_arg(ap, long long) : va_arg(ap, int);
+            if (v < 0) num[n++] = '-';
+            n += tiny_digits(num + n, v < 0 ? -(unsigned long long)v : (unsigned long long)v, 10);
+            break;
+        }
+        case 'u': case 'x': {
+            unsigned long long v = lng ? va_arg(ap, unsigned long long) : va_arg(ap, unsigned int);
+            n = tiny_digits(num, v, *fmt == 'x' ? 16 : 10);
+            break;
+        }
+        case 'f':
+            n = tiny_fixed(num, va_arg(ap, double), prec < 0 ? 6 : prec);
+            break;
+        case 'c':
+            num[n++] = (char)va_arg(ap, int);
+            break;
+        case 's':
+            s = va_arg(ap, const char*);
+            if (!s) s = "(null)";
+            n = prec >= 0 ? (int)strnlen(s, prec) : (int)strlen(s);
+            break;
+        case '%':
+            num[n++] = '%';
+            break;
+        default:
+            return -1;
+        }
+        if (!left) tiny_pad(&o, zero && *fmt != 's' ? '0' : ' ', width - n);
+        for (int i = 0; i < n; i++) tiny_putc(&o, s[i]);
+        if (left) tiny_pad(&o, ' ', width - n);
+    }
+    if (size) buf[o.len < size ? o.len : size - 1] = '\0';
+    return (int)o.len;
+}
+
+int snprintf(char* buf, size_t size, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+// --------------------------------------------------------------------------------
+// Unbuffered stdio: every call is one write(2) to fd 1 or 2
+// --------------------------------------------------------------------------------
+
+static int g_stdout_tag, g_stderr_tag;
+FILE* stdout = (FILE*)&g_stdout_tag;
+FILE* stderr = (FILE*)&g_stderr_tag;
+
+static int tiny_fd(FILE* f) {
+    return f == stderr ? 2 : 1;
+}
+
+static int tiny_vdprintf(int fd, const char* fmt, va_list ap) {
+    char buf[1024];
+    va_list copy;
+    va_copy(copy, ap);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    if (n >= (int)sizeof(buf)) {
+        char* big = malloc(n + 1);
+        if (big) { vsnprintf(big, n + 1, fmt, copy); write(fd, big, n); free(big); }
+    } else if (n > 0) {
+        write(fd, buf, n);
+    }
+    va_end(copy);
+    return n;
+}
+
+int printf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = tiny_vdprintf(1, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+int fprintf(FILE* f, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = tiny_vdprintf(tiny_fd(f), fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+int puts(const char* s) {
+    struct iovec iov[2] = { { (void*)s, strlen(s) }, { "\n", 1 } };
+    return writev(1, iov, 2) < 0 ? EOF : 0;
+}
+
+int fputc(int c, FILE* f) {
+    char ch = (char)c;
+    return write(tiny_fd(f), &ch, 1) == 1 ? c : EOF;
+}
+
+int putchar(int c) {
+    return fputc(c, stdout);
+}
+
+int fputs(const char* s, FILE* f) {
+    return write(tiny_fd(f), s, strlen(s)) < 0 ? EOF : 0;
+}
+
+size_t fwrite(const void* p, size_t size, size_t n, FILE* f) {
+    ssize_t w = write(tiny_fd(f), p, size * n);
+    return (w < 0 || size == 0) ? 0 : (size_t)w / size;
+}
+
+// --------------------------------------------------------------------------------
+// Directory Streams: one getdents64 buffer per open directory
+// --------------------------------------------------------------------------------
+
+struct __dirstream {
+    int fd;
+    int pos;
+    int len;
+    char buf[16384];
+};
+
+DIR* opendir(const char* path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return NULL;
+    DIR* d = malloc(sizeof(*d));
+    if (!d) { close(fd); return NULL; }
+    d->fd = fd;
+    d->pos = d->len = 0;
+    return d;
+}
+
+struct dirent* readdir(DIR* d) {
+    if (d->pos >= d->len) {
+        long n = syscall(SYS_getdents64, d->fd, d->buf, sizeof(d->buf));
+        if (n <= 0) return NULL;
+        d->len = (int)n;
+        d->pos = 0;
+    }
+    // struct dirent has the same layout as the kernel's linux_dirent64 on 64-bit targets
+    struct dirent* de = (struct dirent*)(d->buf + d->pos);
+    d->pos += de->d_reclen;
+    return de;
+}
+
+int closedir(DIR* d) {
+    int r = close(d->fd);
+    free(d);
+    return r;
+}
+
+#endif